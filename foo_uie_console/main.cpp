@@ -29,10 +29,14 @@ DECLARE_COMPONENT_VERSION("Console panel", console_panel::version,
 constexpr auto IDC_EDIT = 1001;
 constexpr auto MSG_UPDATE = WM_USER + 2;
 constexpr auto ID_TIMER = 667;
+constexpr auto ID_HISTORY_TIMER = 668;
 
 /** \brief The maximum number of message we cache/display */
 constexpr t_size maximum_messages = 200;
 
+/** \brief The maximum number of lines, across all messages, we cache/display */
+constexpr t_size maximum_lines = 10'000;
+
 cfg_int cfg_last_edge_style(
     GUID{0x05550547, 0xbf98, 0x088c, {0xbe, 0x0e, 0x24, 0x95, 0xe4, 0x9b, 0x88, 0xc7}}, WI_EnumValue(EdgeStyle::None));
 
@@ -49,6 +53,27 @@ constexpr GUID console_colours_client_id
 
 constexpr auto current_config_version = 0;
 
+struct HistoryDurationOption {
+    std::chrono::seconds duration;
+    const char* label;
+};
+
+constexpr std::array history_duration_options{
+    HistoryDurationOption{10s, "Last 10 seconds"},
+    HistoryDurationOption{30s, "Last 30 seconds"},
+    HistoryDurationOption{1min, "Last minute"},
+    HistoryDurationOption{5min, "Last 5 minutes"},
+};
+
+Message::Message(std::chrono::system_clock::time_point timestamp,
+    std::chrono::steady_clock::time_point received_time_point, std::wstring message)
+    : m_timestamp(timestamp)
+    , m_received_time_point(received_time_point)
+    , m_message(std::move(message))
+    , m_line_count(gsl::narrow<uint32_t>(std::ranges::count(m_message, L'\n') + 1))
+{
+}
+
 void ConsoleWindow::s_update_all_fonts()
 {
     const auto old_font = std::move(s_font);
@@ -107,6 +132,135 @@ void ConsoleWindow::set_timestamp_mode(TimestampMode mode)
     update_content_throttled();
 }
 
+void ConsoleWindow::set_history_duration(std::optional<std::chrono::seconds> duration)
+{
+    m_history_duration = duration;
+    update_content_throttled();
+}
+
+MessageRange ConsoleWindow::s_get_messages_in_time_range(
+    std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    const auto& messages = std::as_const(s_messages);
+    const auto first = std::ranges::lower_bound(messages, start, {}, &Message::m_received_time_point);
+    const auto last = std::ranges::lower_bound(first, messages.end(), end, {}, &Message::m_received_time_point);
+    return {first, last};
+}
+
+namespace {
+
+struct TimestampPrefix {
+    size_t offset{};
+    size_t length{};
+};
+
+/**
+ * Formats messages for display, with a separate instantiation for each display configuration so that the
+ * per-message loops don't need to check it.
+ *
+ * A first pass formats timestamp prefixes (once per distinct second, as that's their resolution) and works out
+ * the exact size of the output, so that the output buffer is only allocated once.
+ */
+template <TimestampMode timestamp_mode, bool hide_trailing_newline>
+std::wstring format_messages(MessageRange messages, const std::locale& locale)
+{
+    constexpr auto newline = L"\r\n"sv;
+    const auto message_count = messages.size();
+
+    std::wstring prefixes;
+    std::vector<TimestampPrefix> message_prefixes;
+    size_t size{};
+
+    if constexpr (timestamp_mode != TimestampMode::None) {
+        message_prefixes.reserve(message_count);
+
+        std::optional<time_t> last_time_t;
+        TimestampPrefix prefix;
+
+        for (auto&& message : messages) {
+            const auto timestamp_time_t = std::chrono::system_clock::to_time_t(message.m_timestamp);
+
+            if (timestamp_time_t != last_time_t) {
+                last_time_t = timestamp_time_t;
+                prefix = {prefixes.size(), 0};
+
+                tm local_time{};
+                if (localtime_s(&local_time, &timestamp_time_t) == 0) {
+                    if constexpr (timestamp_mode == TimestampMode::DateAndTime)
+                        fmt::format_to(std::back_inserter(prefixes), locale, L"[{:L%c}] ", local_time);
+                    else
+                        fmt::format_to(std::back_inserter(prefixes), locale, L"[{:L%X}] ", local_time);
+
+                    prefix.length = prefixes.size() - prefix.offset;
+                }
+            }
+
+            message_prefixes.emplace_back(prefix);
+            size += prefix.length;
+        }
+    }
+
+    for (auto&& message : messages)
+        size += message.m_message.size();
+
+    if (message_count > 0)
+        size += newline.size() * (hide_trailing_newline ? message_count - 1 : message_count);
+
+    std::wstring buffer;
+    buffer.reserve(size);
+
+    for (size_t index{}; auto&& message : messages) {
+        if constexpr (timestamp_mode != TimestampMode::None) {
+            const auto [offset, length] = message_prefixes[index];
+            buffer.append(prefixes, offset, length);
+        }
+
+        buffer.append(message.m_message);
+
+        if (!hide_trailing_newline || index + 1 < message_count)
+            buffer.append(newline);
+
+        ++index;
+    }
+
+    return buffer;
+}
+
+template <TimestampMode timestamp_mode>
+std::wstring format_messages(MessageRange messages, bool hide_trailing_newline, const std::locale& locale)
+{
+    if (hide_trailing_newline)
+        return format_messages<timestamp_mode, true>(messages, locale);
+
+    return format_messages<timestamp_mode, false>(messages, locale);
+}
+
+} // namespace
+
+std::wstring ConsoleWindow::s_format_messages(
+    MessageRange messages, TimestampMode timestamp_mode, bool hide_trailing_newline, const std::locale& locale)
+{
+    switch (timestamp_mode) {
+    case TimestampMode::None:
+        return format_messages<TimestampMode::None>(messages, hide_trailing_newline, locale);
+    case TimestampMode::DateAndTime:
+        _tzset();
+        return format_messages<TimestampMode::DateAndTime>(messages, hide_trailing_newline, locale);
+    default:
+        _tzset();
+        return format_messages<TimestampMode::Time>(messages, hide_trailing_newline, locale);
+    }
+}
+
+size_t ConsoleWindow::s_get_line_count()
+{
+    if (s_messages.empty())
+        return 0;
+
+    const auto& last_message = s_messages.back();
+    return last_message.m_first_line + last_message.m_line_count - s_messages.front().m_first_line;
+}
+
 void ConsoleWindow::s_on_message_received(std::string_view text)
 {
     std::scoped_lock _(s_mutex);
@@ -143,17 +297,39 @@ void ConsoleWindow::s_on_message_received(std::string_view text)
 
     fixed_text.resize(trim_pos + 1);
 
-    s_messages.emplace_back(mmh::to_utf16(fixed_text));
+    const auto first_line
+        = s_messages.empty() ? 0 : s_messages.back().m_first_line + s_messages.back().m_line_count;
+
+    auto& message = s_messages.emplace_back(mmh::to_utf16(fixed_text));
+    message.m_first_line = first_line;
+
+    if (s_message_stream)
+        s_message_stream->publish(message.m_timestamp, fixed_text);
 
     if (s_messages.size() == maximum_messages)
         s_messages.pop_front();
 
+    while (s_messages.size() > 1 && s_get_line_count() > maximum_lines)
+        s_messages.pop_front();
+
     /** Post a notification to all instances of the panel to update their display */
     for (auto&& wnd : s_notify_list) {
         PostMessage(wnd, MSG_UPDATE, 0, 0);
     }
 }
 
+void ConsoleWindow::s_set_message_stream(std::unique_ptr<MessageStream> message_stream)
+{
+    std::unique_ptr<MessageStream> old_message_stream;
+
+    {
+        std::scoped_lock _(s_mutex);
+        old_message_stream = std::exchange(s_message_stream, std::move(message_stream));
+    }
+
+    /** old_message_stream is destroyed here, after releasing the lock, as that waits for its threads to exit */
+}
+
 void ConsoleWindow::copy() const
 {
     DWORD start{};
@@ -247,6 +423,38 @@ private:
     std::vector<uie::simple_command_menu_node> m_nodes;
 };
 
+class HistoryDurationMenuNode : public uie::menu_node_popup_t {
+public:
+    HistoryDurationMenuNode(service_ptr_t<ConsoleWindow> window)
+    {
+        const auto current_history_duration = window->get_history_duration();
+
+        m_nodes.emplace_back("All messages", "Show all messages", !current_history_duration ? state_radiochecked : 0,
+            [window] { window->set_history_duration({}); });
+
+        for (auto&& option : history_duration_options) {
+            m_nodes.emplace_back(option.label, "Only show messages logged in the chosen length of time before now",
+                current_history_duration == option.duration ? state_radiochecked : 0,
+                [window, duration = option.duration] { window->set_history_duration(duration); });
+        }
+    }
+
+    t_size get_children_count() const override { return m_nodes.size(); }
+    void get_child(t_size index, uie::menu_node_ptr& p_out) const override
+    {
+        if (index < m_nodes.size())
+            p_out = new uie::simple_command_menu_node(m_nodes[index]);
+    }
+    bool get_display_data(pfc::string_base& p_out, unsigned& p_state) const override
+    {
+        p_out = "Show";
+        return true;
+    }
+
+private:
+    std::vector<uie::simple_command_menu_node> m_nodes;
+};
+
 class EdgeStyleMenuNode : public uie::menu_node_popup_t {
 public:
     EdgeStyleMenuNode(service_ptr_t<ConsoleWindow> window)
@@ -284,6 +492,7 @@ private:
 
 void ConsoleWindow::get_menu_items(uie::menu_hook_t& p_hook)
 {
+    p_hook.add_node(new HistoryDurationMenuNode(this));
     p_hook.add_node(new TimestampModeMenuNode(this));
     p_hook.add_node(new EdgeStyleMenuNode(this));
     p_hook.add_node(
@@ -308,33 +517,26 @@ void ConsoleWindow::update_content()
     const std::locale locale("");
 
     std::scoped_lock _(s_mutex);
-    std::wstring buffer;
-    buffer.reserve(1024);
-
-    tm local_time{};
 
-    if (m_timestamp_mode != TimestampMode::None)
-        _tzset();
-
-    for (auto iter = s_messages.begin(); iter != s_messages.end(); ++iter) {
-        const auto timestamp_time_t = std::chrono::system_clock::to_time_t(iter->m_timestamp);
-        const auto localtime_result = localtime_s(&local_time, &timestamp_time_t);
+    const auto now = std::chrono::steady_clock::now();
+    const auto messages = m_history_duration ? s_get_messages_in_time_range(now - *m_history_duration)
+                                             : MessageRange(s_messages.cbegin(), s_messages.cend());
+    const auto text = s_format_messages(messages, m_timestamp_mode, m_hide_trailing_newline, locale);
 
-        if (localtime_result != 0 || m_timestamp_mode == TimestampMode::None)
-            buffer.append(iter->m_message);
-        else if (m_timestamp_mode == TimestampMode::DateAndTime)
-            fmt::format_to(std::back_inserter(buffer), locale, L"[{:L%c}] {}", local_time, iter->m_message);
-        else
-            fmt::format_to(std::back_inserter(buffer), locale, L"[{:L%X}] {}", local_time, iter->m_message);
+    SetWindowText(m_wnd_edit, text.c_str());
+    SendMessage(m_wnd_edit, WM_VSCROLL, SB_BOTTOM, 0);
+    m_last_update_time_point = std::chrono::steady_clock::now();
 
-        if (!m_hide_trailing_newline || std::next(iter) != s_messages.end())
-            buffer.append(L"\r\n"sv);
+    /** Update again when the oldest message shown falls outside of the history duration */
+    if (m_history_duration && !messages.empty()) {
+        const auto time_until_expiry = messages.front().m_received_time_point + *m_history_duration - now;
+        const auto ms_until_expiry = std::chrono::ceil<std::chrono::milliseconds>(time_until_expiry).count();
+        SetTimer(get_wnd(), ID_HISTORY_TIMER,
+            static_cast<uint32_t>(std::clamp<int64_t>(ms_until_expiry, USER_TIMER_MINIMUM, USER_TIMER_MAXIMUM)),
+            nullptr);
+    } else {
+        KillTimer(get_wnd(), ID_HISTORY_TIMER);
     }
-
-    SetWindowText(m_wnd_edit, buffer.c_str());
-    const int len = Edit_GetLineCount(m_wnd_edit);
-    Edit_Scroll(m_wnd_edit, len, 0);
-    m_last_update_time_point = std::chrono::steady_clock::now();
 }
 
 void ConsoleWindow::update_content_throttled() noexcept
@@ -408,6 +610,11 @@ LRESULT ConsoleWindow::on_message(HWND wnd, UINT msg, WPARAM wp, LPARAM lp)
             update_content();
             return 0;
         }
+        if (wp == ID_HISTORY_TIMER) {
+            KillTimer(wnd, ID_HISTORY_TIMER);
+            update_content_throttled();
+            return 0;
+        }
         break;
     /** Update the edit window's text */
     case MSG_UPDATE:
@@ -496,6 +703,18 @@ std::optional<LRESULT> ConsoleWindow::handle_edit_message(WNDPROC wnd_proc, HWND
         menu.append_command(command_collector.add([] { s_clear(); }), L"Clear");
         menu.append_separator();
 
+        uih::Menu history_duration_submenu;
+        history_duration_submenu.append_command(command_collector.add([this] { set_history_duration({}); }),
+            L"All messages", {.is_radio_checked = !m_history_duration});
+
+        for (auto&& option : history_duration_options) {
+            history_duration_submenu.append_command(
+                command_collector.add([this, duration = option.duration] { set_history_duration(duration); }),
+                mmh::to_utf16(option.label).c_str(), {.is_radio_checked = m_history_duration == option.duration});
+        }
+
+        menu.append_submenu(std::move(history_duration_submenu), L"Show");
+
         uih::Menu timestamp_mode_submenu;
         timestamp_mode_submenu.append_command(
             command_collector.add([this] { set_timestamp_mode(TimestampMode::None); }), L"None",
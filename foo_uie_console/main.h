@@ -3,10 +3,15 @@
 #define NOMINMAX
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <deque>
 #include <locale>
+#include <memory>
 #include <mutex>
+#include <ranges>
+#include <thread>
 #include <vector>
 
 #include <fmt/xchar.h>
@@ -23,6 +28,7 @@
 #include "../columns_ui-sdk/ui_extension.h"
 
 #include "version.h"
+#include "message_stream.h"
 
 /**
  * This is the unique GUID identifying our panel. You should not re-use this one
@@ -49,17 +55,35 @@ enum class TimestampMode : int32_t {
 class Message {
 public:
     std::chrono::system_clock::time_point m_timestamp;
+    /** Monotonic time the message was received, used to look up messages by time */
+    std::chrono::steady_clock::time_point m_received_time_point;
     std::wstring m_message;
+    uint32_t m_line_count{};
+    /** Line number of the first line of the message, counted across all messages in the history */
+    size_t m_first_line{};
 
-    Message(std::wstring message) : m_timestamp(std::chrono::system_clock::now()), m_message(std::move(message)) {}
+    Message(std::wstring message) : Message(std::chrono::system_clock::now(), std::move(message)) {}
+    Message(std::chrono::system_clock::time_point timestamp, std::wstring message)
+        : Message(timestamp, std::chrono::steady_clock::now(), std::move(message))
+    {
+    }
+    Message(std::chrono::system_clock::time_point timestamp,
+        std::chrono::steady_clock::time_point received_time_point, std::wstring message);
 };
 
+using MessageRange = std::ranges::subrange<std::deque<Message>::const_iterator>;
+
 class ConsoleWindow : public uie::container_uie_window_v3 {
 public:
     static void s_update_all_fonts();
     static void s_update_colours();
     static void s_update_window_themes();
     static void s_on_message_received(std::string_view text); // from any thread
+    static void s_set_message_stream(std::unique_ptr<MessageStream> message_stream);
+
+    /** Formats messages for display in the edit control. */
+    static std::wstring s_format_messages(
+        MessageRange messages, TimestampMode timestamp_mode, bool hide_trailing_newline, const std::locale& locale);
 
     const GUID& get_extension_guid() const override { return window_id; }
     void get_name(pfc::string_base& out) const override { out.set_string("Console"); }
@@ -87,10 +111,22 @@ public:
     void set_hide_trailing_newline(bool hide_trailing_newline);
     TimestampMode get_timestamp_mode() const { return m_timestamp_mode; }
     void set_timestamp_mode(TimestampMode mode);
+    std::optional<std::chrono::seconds> get_history_duration() const { return m_history_duration; }
+    void set_history_duration(std::optional<std::chrono::seconds> duration);
 
 protected:
     static void s_clear();
 
+    /** Returns the total number of lines in all messages. The caller must hold s_mutex. */
+    static size_t s_get_line_count();
+
+    /**
+     * Returns the messages received in [start, end). Received time points are
+     * non-decreasing, so this is a binary search. The caller must hold s_mutex.
+     */
+    static MessageRange s_get_messages_in_time_range(std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::time_point::max());
+
     LRESULT on_message(HWND wnd, UINT msg, WPARAM wp, LPARAM lp) override;
     std::optional<LRESULT> handle_edit_message(WNDPROC wnd_proc, HWND wnd, UINT msg, WPARAM wp, LPARAM lp);
     void set_window_theme() const;
@@ -100,6 +136,7 @@ protected:
     inline static wil::unique_hfont s_font;
     inline static wil::unique_hbrush s_background_brush;
     inline static std::deque<Message> s_messages;
+    inline static std::unique_ptr<MessageStream> s_message_stream;
     inline static std::vector<HWND> s_notify_list;
     inline static std::vector<service_ptr_t<ConsoleWindow>> s_windows;
 
@@ -109,4 +146,5 @@ protected:
     EdgeStyle m_edge_style{cfg_last_edge_style.get_value()};
     TimestampMode m_timestamp_mode{cfg_last_timestamp_mode.get_value()};
     bool m_hide_trailing_newline{cfg_last_hide_trailing_newline.get_value()};
+    std::optional<std::chrono::seconds> m_history_duration;
 };
@@ -0,0 +1,314 @@
+#include "main.h"
+
+#include <sddl.h>
+
+#include <wil/token_helpers.h>
+
+namespace {
+
+constexpr DWORD pipe_buffer_size = 64 * 1024;
+
+advconfig_checkbox_factory cfg_message_stream_enabled(
+    "Console panel: Publish console messages to a named pipe (requires restart)",
+    GUID{0x6f0c52a1, 0x1d7e, 0x4b8a, {0x9e, 0x3c, 0x52, 0x0b, 0x8d, 0x71, 0xa4, 0x2f}},
+    advconfig_branch::guid_branch_tools, 0, false);
+
+std::string encode_record(std::chrono::system_clock::time_point timestamp, std::string_view text)
+{
+    const int64_t timestamp_us
+        = std::chrono::duration_cast<std::chrono::microseconds>(timestamp.time_since_epoch()).count();
+    const auto payload_size = gsl::narrow<uint32_t>(sizeof(timestamp_us) + text.size());
+
+    std::string record(sizeof(payload_size) + payload_size, '\0');
+    auto* data = record.data();
+    memcpy(data, &payload_size, sizeof(payload_size));
+    memcpy(data + sizeof(payload_size), &timestamp_us, sizeof(timestamp_us));
+    memcpy(data + sizeof(payload_size) + sizeof(timestamp_us), text.data(), text.size());
+    return record;
+}
+
+/** Creates a security descriptor that only grants access to the current user */
+wil::unique_hlocal_security_descriptor create_current_user_security_descriptor()
+{
+    const auto token_user = wil::get_token_information<TOKEN_USER>();
+
+    wil::unique_hlocal_string sid_string;
+    THROW_IF_WIN32_BOOL_FALSE(ConvertSidToStringSid(token_user->User.Sid, &sid_string));
+
+    const auto sddl = fmt::format(L"D:P(A;;GA;;;{})", sid_string.get());
+
+    wil::unique_hlocal_security_descriptor security_descriptor;
+    THROW_IF_WIN32_BOOL_FALSE(ConvertStringSecurityDescriptorToSecurityDescriptor(
+        sddl.c_str(), SDDL_REVISION_1, &security_descriptor, nullptr));
+
+    return security_descriptor;
+}
+
+void log_pipe_error(std::wstring_view pipe_name, const char* action, DWORD error)
+{
+    console::formatter() << "Console panel: " << action << " "
+                         << pfc::stringcvt::string_utf8_from_wide(pipe_name.data(), pipe_name.size()) << " failed: "
+                         << exception_win32(error).what();
+}
+
+} // namespace
+
+class MessageStream::Client {
+public:
+    Client(wil::unique_hfile pipe, size_t max_queued_records)
+        : m_pipe(std::move(pipe))
+        , m_max_queued_records(max_queued_records)
+        , m_thread([this] { run(); })
+    {
+    }
+
+    ~Client() { m_stop_event.SetEvent(); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    bool is_finished() const { return m_is_finished; }
+
+    void push(const std::shared_ptr<const std::string>& record)
+    {
+        {
+            std::scoped_lock _(m_mutex);
+
+            /** The client isn't keeping up, so drop it rather than letting the queue grow */
+            if (m_records.size() >= m_max_queued_records) {
+                m_stop_event.SetEvent();
+                return;
+            }
+
+            m_records.emplace_back(record);
+        }
+        m_records_event.SetEvent();
+    }
+
+private:
+    void run()
+    {
+        std::vector<std::shared_ptr<const std::string>> records;
+        std::string batch;
+
+        while (true) {
+            const std::array wait_handles{m_stop_event.get(), m_records_event.get()};
+
+            if (WaitForMultipleObjects(gsl::narrow<DWORD>(wait_handles.size()), wait_handles.data(), FALSE, INFINITE)
+                != WAIT_OBJECT_0 + 1)
+                break;
+
+            records.clear();
+            {
+                std::scoped_lock _(m_mutex);
+                std::swap(records, m_records);
+            }
+
+            batch.clear();
+            for (auto&& record : records)
+                batch.append(*record);
+
+            if (!batch.empty() && !write(batch))
+                break;
+        }
+
+        DisconnectNamedPipe(m_pipe.get());
+        m_is_finished = true;
+    }
+
+    bool write(std::string_view data)
+    {
+        while (!data.empty()) {
+            OVERLAPPED overlapped{};
+            overlapped.hEvent = m_write_event.get();
+
+            DWORD bytes_written{};
+            if (!WriteFile(m_pipe.get(), data.data(), gsl::narrow<DWORD>(data.size()), nullptr, &overlapped)) {
+                if (GetLastError() != ERROR_IO_PENDING)
+                    return false;
+
+                const std::array wait_handles{m_stop_event.get(), m_write_event.get()};
+
+                if (WaitForMultipleObjects(
+                        gsl::narrow<DWORD>(wait_handles.size()), wait_handles.data(), FALSE, INFINITE)
+                    != WAIT_OBJECT_0 + 1) {
+                    CancelIoEx(m_pipe.get(), &overlapped);
+                    GetOverlappedResult(m_pipe.get(), &overlapped, &bytes_written, TRUE);
+                    return false;
+                }
+            }
+
+            if (!GetOverlappedResult(m_pipe.get(), &overlapped, &bytes_written, FALSE))
+                return false;
+
+            data.remove_prefix(bytes_written);
+        }
+
+        return true;
+    }
+
+    wil::unique_hfile m_pipe;
+    size_t m_max_queued_records{};
+    wil::unique_event m_stop_event{wil::EventOptions::ManualReset};
+    wil::unique_event m_records_event{wil::EventOptions::None};
+    wil::unique_event m_write_event{wil::EventOptions::ManualReset};
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<const std::string>> m_records;
+    std::atomic<bool> m_is_finished{};
+    std::jthread m_thread;
+};
+
+std::wstring MessageStream::s_get_default_pipe_name()
+{
+    return fmt::format(L"\\\\.\\pipe\\foo_uie_console-{}", GetCurrentProcessId());
+}
+
+MessageStream::MessageStream(std::wstring pipe_name, size_t max_queued_records)
+    : m_pipe_name(std::move(pipe_name))
+    , m_max_queued_records(max_queued_records)
+    , m_security_descriptor(create_current_user_security_descriptor())
+    , m_listen_thread([this, pipe = create_first_pipe_instance()]() mutable {
+        listen(std::move(pipe));
+    })
+{
+}
+
+MessageStream::~MessageStream()
+{
+    m_stop_event.SetEvent();
+    m_listen_thread.join();
+
+    /** Client destructors stop and join their threads */
+    m_clients.clear();
+}
+
+size_t MessageStream::get_client_count() const
+{
+    std::scoped_lock _(m_mutex);
+    return gsl::narrow<size_t>(
+        std::ranges::count_if(m_clients, [](auto&& client) { return !client->is_finished(); }));
+}
+
+void MessageStream::publish(std::chrono::system_clock::time_point timestamp, std::string_view text)
+{
+    std::scoped_lock _(m_mutex);
+
+    std::erase_if(m_clients, [](auto&& client) { return client->is_finished(); });
+
+    if (m_clients.empty())
+        return;
+
+    /** Records are encoded once and shared between all clients */
+    const auto record = std::make_shared<const std::string>(encode_record(timestamp, text));
+
+    for (auto&& client : m_clients)
+        client->push(record);
+}
+
+wil::unique_hfile MessageStream::create_pipe_instance(DWORD extra_open_mode) const
+{
+    SECURITY_ATTRIBUTES security_attributes{sizeof(security_attributes), m_security_descriptor.get(), FALSE};
+
+    wil::unique_hfile pipe(CreateNamedPipe(m_pipe_name.c_str(),
+        PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED | extra_open_mode,
+        PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES, pipe_buffer_size, 0, 0,
+        &security_attributes));
+
+    return pipe;
+}
+
+wil::unique_hfile MessageStream::create_first_pipe_instance() const
+{
+    /** Fail if something else has already created a pipe with this name, rather than sharing it */
+    auto pipe = create_pipe_instance(FILE_FLAG_FIRST_PIPE_INSTANCE);
+
+    if (!pipe)
+        throw exception_win32(GetLastError());
+
+    return pipe;
+}
+
+void MessageStream::listen(wil::unique_hfile pipe)
+{
+    wil::unique_event connect_event(wil::EventOptions::ManualReset);
+
+    while (true) {
+        if (!pipe) {
+            pipe = create_pipe_instance();
+
+            if (!pipe) {
+                log_pipe_error(m_pipe_name, "Creating named pipe", GetLastError());
+                return;
+            }
+        }
+
+        OVERLAPPED overlapped{};
+        overlapped.hEvent = connect_event.get();
+
+        bool is_connected = ConnectNamedPipe(pipe.get(), &overlapped) != FALSE;
+        DWORD error = is_connected ? ERROR_SUCCESS : GetLastError();
+
+        if (error == ERROR_PIPE_CONNECTED) {
+            is_connected = true;
+        } else if (error == ERROR_IO_PENDING) {
+            const std::array wait_handles{m_stop_event.get(), connect_event.get()};
+            DWORD bytes_transferred{};
+
+            if (WaitForMultipleObjects(gsl::narrow<DWORD>(wait_handles.size()), wait_handles.data(), FALSE, INFINITE)
+                != WAIT_OBJECT_0 + 1) {
+                CancelIoEx(pipe.get(), &overlapped);
+                GetOverlappedResult(pipe.get(), &overlapped, &bytes_transferred, TRUE);
+                return;
+            }
+
+            is_connected = GetOverlappedResult(pipe.get(), &overlapped, &bytes_transferred, FALSE) != FALSE;
+            error = is_connected ? ERROR_SUCCESS : GetLastError();
+        }
+
+        if (!is_connected) {
+            pipe.reset();
+
+            /** The client disconnected before the connection completed, so just wait for the next one */
+            if (error == ERROR_NO_DATA)
+                continue;
+
+            log_pipe_error(m_pipe_name, "Connecting to named pipe", error);
+
+            /** Back off before retrying, so that a persistent error doesn't make this loop spin */
+            if (WaitForSingleObject(m_stop_event.get(), 1000) != WAIT_TIMEOUT)
+                return;
+
+            continue;
+        }
+
+        auto client = std::make_shared<Client>(std::move(pipe), m_max_queued_records);
+
+        std::scoped_lock _(m_mutex);
+        m_clients.emplace_back(std::move(client));
+    }
+}
+
+class MessageStreamInitQuit : public initquit {
+    void on_init() override
+    {
+        if (!cfg_message_stream_enabled.get())
+            return;
+
+        const auto pipe_name = MessageStream::s_get_default_pipe_name();
+
+        try {
+            auto message_stream = std::make_unique<MessageStream>(pipe_name);
+            console::formatter() << "Console panel: Publishing console messages to "
+                                 << pfc::stringcvt::string_utf8_from_wide(pipe_name.c_str());
+            ConsoleWindow::s_set_message_stream(std::move(message_stream));
+        } catch (const std::exception& ex) {
+            console::formatter() << "Console panel: Creating named pipe "
+                                 << pfc::stringcvt::string_utf8_from_wide(pipe_name.c_str())
+                                 << " failed: " << ex.what();
+        }
+    }
+
+    void on_quit() override { ConsoleWindow::s_set_message_stream({}); }
+};
+
+static initquit_factory_t<MessageStreamInitQuit> message_stream_initquit;
@@ -0,0 +1,51 @@
+#pragma once
+
+/**
+ * \brief Publishes console messages to local clients over a named pipe
+ *
+ * Clients open the pipe for reading and receive a stream of records. Each
+ * record is a little-endian uint32_t payload size followed by the payload: a
+ * little-endian int64_t timestamp (microseconds since the Unix epoch) and the
+ * UTF-8 text of the message.
+ *
+ * The pipe is only accessible to the current user, and creating the stream fails
+ * if another process already owns the pipe name.
+ *
+ * Each client has a bounded queue of pending records, which are written to the
+ * pipe in batches by a thread belonging to that client. Publishing never waits
+ * for client I/O; a client that falls far enough behind for its queue to fill
+ * up is disconnected.
+ */
+class MessageStream {
+public:
+    static constexpr size_t default_max_queued_records = 4096;
+
+    static std::wstring s_get_default_pipe_name();
+
+    /** Throws if the pipe can't be created. */
+    explicit MessageStream(std::wstring pipe_name, size_t max_queued_records = default_max_queued_records);
+    ~MessageStream();
+
+    MessageStream(const MessageStream&) = delete;
+    MessageStream& operator=(const MessageStream&) = delete;
+
+    const std::wstring& get_pipe_name() const { return m_pipe_name; }
+    size_t get_client_count() const;
+
+    void publish(std::chrono::system_clock::time_point timestamp, std::string_view text); // from any thread
+
+private:
+    class Client;
+
+    wil::unique_hfile create_pipe_instance(DWORD extra_open_mode = 0) const;
+    wil::unique_hfile create_first_pipe_instance() const;
+    void listen(wil::unique_hfile pipe);
+
+    std::wstring m_pipe_name;
+    size_t m_max_queued_records{};
+    wil::unique_hlocal_security_descriptor m_security_descriptor;
+    wil::unique_event m_stop_event{wil::EventOptions::ManualReset};
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<Client>> m_clients;
+    std::jthread m_listen_thread;
+};
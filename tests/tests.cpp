@@ -2,17 +2,34 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 
+using namespace std::string_literals;
 using namespace std::string_view_literals;
+using namespace std::chrono_literals;
 
 class ConsoleWindowTestImpl
     : public window_implementation<ConsoleWindow, false> {
 public:
+  using ConsoleWindow::s_get_line_count;
+  using ConsoleWindow::s_get_messages_in_time_range;
+
   static Message s_process_message(std::string_view text) {
     s_on_message_received(text);
     Message message = s_messages.back();
     s_messages.pop_back();
     return message;
   }
+
+  static void s_replace_messages(std::initializer_list<Message> messages) {
+    s_messages.assign(messages);
+  }
+
+  static void
+  s_receive_messages(std::initializer_list<std::string_view> messages) {
+    s_messages.clear();
+
+    for (auto &&message : messages)
+      s_on_message_received(message);
+  }
 };
 
 auto normalise_message(std::string_view text) {
@@ -31,3 +48,323 @@ TEST_CASE("normalises message line endings") {
   CHECK(normalise_message("Test\n\nTest"sv) == L"Test\r\n\r\nTest"sv);
   CHECK(normalise_message("Test\r\n\r\nTest"sv) == L"Test\r\n\r\nTest"sv);
 }
+
+auto get_messages_in_time_range(
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::time_point::max()) {
+  std::vector<std::wstring> messages;
+
+  for (auto &&message :
+       ConsoleWindowTestImpl::s_get_messages_in_time_range(start, end))
+    messages.emplace_back(message.m_message);
+
+  return messages;
+}
+
+TEST_CASE("finds messages in time range") {
+  const std::chrono::steady_clock::time_point epoch;
+
+  /** Wall-clock timestamps are deliberately out of order, as they aren't used
+   * for lookups */
+  const auto now = std::chrono::system_clock::now();
+
+  ConsoleWindowTestImpl::s_replace_messages({{now, epoch + 1s, L"One"},
+                                             {now - 1h, epoch + 2s, L"Two"},
+                                             {now, epoch + 2s, L"Three"},
+                                             {now - 1h, epoch + 4s, L"Four"}});
+
+  using Messages = std::vector<std::wstring>;
+
+  CHECK(get_messages_in_time_range(epoch) ==
+        Messages{L"One", L"Two", L"Three", L"Four"});
+  CHECK(get_messages_in_time_range(epoch + 2s) ==
+        Messages{L"Two", L"Three", L"Four"});
+  CHECK(get_messages_in_time_range(epoch + 3s) == Messages{L"Four"});
+  CHECK(get_messages_in_time_range(epoch + 5s).empty());
+  CHECK(get_messages_in_time_range(epoch + 1s, epoch + 4s) ==
+        Messages{L"One", L"Two", L"Three"});
+  CHECK(get_messages_in_time_range(epoch + 2s, epoch + 2s).empty());
+
+  ConsoleWindowTestImpl::s_replace_messages({});
+}
+
+TEST_CASE("counts message lines") {
+  CHECK(Message(L"One"s).m_line_count == 1);
+  CHECK(Message(L"One\r\nTwo\r\n\r\nFour"s).m_line_count == 4);
+
+  ConsoleWindowTestImpl::s_receive_messages(
+      {"One"sv, "Two\nThree"sv, "Four\r\nFive\r\nSix"sv});
+
+  CHECK(ConsoleWindowTestImpl::s_get_line_count() == 6);
+
+  ConsoleWindowTestImpl::s_replace_messages({});
+}
+
+TEST_CASE("evicts messages over the line budget") {
+  std::string long_message;
+
+  for (size_t index{}; index < 10'000; ++index)
+    long_message.append("Line\n"sv);
+
+  ConsoleWindowTestImpl::s_receive_messages({long_message, "One"sv});
+
+  CHECK(ConsoleWindowTestImpl::s_get_line_count() == 1);
+
+  ConsoleWindowTestImpl::s_replace_messages({});
+}
+
+/** The per-message formatting loop that ConsoleWindow::s_format_messages() replaced */
+std::wstring format_messages_reference(MessageRange messages,
+                                       TimestampMode timestamp_mode,
+                                       bool hide_trailing_newline,
+                                       const std::locale &locale) {
+  std::wstring buffer;
+  buffer.reserve(1024);
+
+  tm local_time{};
+
+  if (timestamp_mode != TimestampMode::None)
+    _tzset();
+
+  for (auto iter = messages.begin(); iter != messages.end(); ++iter) {
+    const auto timestamp_time_t =
+        std::chrono::system_clock::to_time_t(iter->m_timestamp);
+    const auto localtime_result = localtime_s(&local_time, &timestamp_time_t);
+
+    if (localtime_result != 0 || timestamp_mode == TimestampMode::None)
+      buffer.append(iter->m_message);
+    else if (timestamp_mode == TimestampMode::DateAndTime)
+      fmt::format_to(std::back_inserter(buffer), locale, L"[{:L%c}] {}",
+                     local_time, iter->m_message);
+    else
+      fmt::format_to(std::back_inserter(buffer), locale, L"[{:L%X}] {}",
+                     local_time, iter->m_message);
+
+    if (!hide_trailing_newline || std::next(iter) != messages.end())
+      buffer.append(L"\r\n"sv);
+  }
+
+  return buffer;
+}
+
+auto make_test_messages(size_t count,
+                        std::chrono::milliseconds interval = 1ms) {
+  std::deque<Message> messages;
+  auto timestamp = std::chrono::system_clock::now();
+
+  for (size_t index{}; index < count; ++index) {
+    messages.emplace_back(timestamp, fmt::format(L"Test message {}", index));
+    timestamp += interval;
+  }
+
+  return messages;
+}
+
+TEST_CASE("formats messages") {
+  const std::locale locale("");
+  const auto messages = make_test_messages(2'000);
+  const MessageRange range(messages.cbegin(), messages.cend());
+
+  for (const auto timestamp_mode :
+       {TimestampMode::None, TimestampMode::Time, TimestampMode::DateAndTime}) {
+    for (const auto hide_trailing_newline : {false, true}) {
+      CHECK(ConsoleWindow::s_format_messages(range, timestamp_mode,
+                                             hide_trailing_newline, locale) ==
+            format_messages_reference(range, timestamp_mode,
+                                      hide_trailing_newline, locale));
+    }
+  }
+
+  const std::deque<Message> no_messages;
+  CHECK(ConsoleWindow::s_format_messages(
+            MessageRange(no_messages.cbegin(), no_messages.cend()),
+            TimestampMode::Time, true, locale)
+            .empty());
+}
+
+TEST_CASE("benchmark message formatting" * doctest::skip()) {
+  const std::locale locale("");
+
+  /** Messages 1 ms apart share timestamp prefixes; messages 1 s apart don't */
+  for (const auto interval : {1ms, 1000ms}) {
+    for (const size_t message_count : {200, 10'000, 100'000}) {
+      const auto messages = make_test_messages(message_count, interval);
+      const MessageRange range(messages.cbegin(), messages.cend());
+
+      const auto time = [&](auto &&format) {
+        const auto start = std::chrono::steady_clock::now();
+        auto text = format(range, TimestampMode::Time, true, locale);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(
+            std::chrono::duration<double, std::milli>(elapsed).count(),
+            std::move(text));
+      };
+
+      const auto [reference_ms, reference_text] =
+          time(format_messages_reference);
+      const auto [specialised_ms, specialised_text] =
+          time(ConsoleWindow::s_format_messages);
+
+      CHECK(specialised_text == reference_text);
+
+      MESSAGE(fmt::format("{} messages {} ms apart: reference {:.2f} ms, "
+                          "specialised {:.2f} ms",
+                          message_count, interval.count(), reference_ms,
+                          specialised_ms));
+    }
+  }
+}
+
+template <class Predicate> bool wait_until(Predicate &&predicate) {
+  const auto deadline = std::chrono::steady_clock::now() + 10s;
+
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+
+    std::this_thread::sleep_for(1ms);
+  }
+
+  return true;
+}
+
+struct StreamRecord {
+  int64_t timestamp_us{};
+  std::string text;
+};
+
+class MessageStreamTestClient {
+public:
+  explicit MessageStreamTestClient(const std::wstring &pipe_name) {
+    REQUIRE(wait_until([&] {
+      m_pipe.reset(CreateFile(pipe_name.c_str(), GENERIC_READ, 0, nullptr,
+                              OPEN_EXISTING, 0, nullptr));
+
+      if (!m_pipe)
+        WaitNamedPipe(pipe_name.c_str(), 100);
+
+      return static_cast<bool>(m_pipe);
+    }));
+  }
+
+  std::optional<StreamRecord> read_record() {
+    uint32_t payload_size{};
+    int64_t timestamp_us{};
+
+    if (!read(&payload_size, sizeof(payload_size)) ||
+        !read(&timestamp_us, sizeof(timestamp_us)))
+      return {};
+
+    std::string text(payload_size - sizeof(timestamp_us), '\0');
+
+    if (!read(text.data(), text.size()))
+      return {};
+
+    return StreamRecord{timestamp_us, std::move(text)};
+  }
+
+private:
+  bool read(void *data, size_t size) {
+    auto *bytes = static_cast<char *>(data);
+
+    while (size > 0) {
+      DWORD bytes_read{};
+      if (!ReadFile(m_pipe.get(), bytes, gsl::narrow<DWORD>(size), &bytes_read,
+                    nullptr))
+        return false;
+
+      bytes += bytes_read;
+      size -= bytes_read;
+    }
+
+    return true;
+  }
+
+  wil::unique_hfile m_pipe;
+};
+
+auto get_test_pipe_name() {
+  static std::atomic<int> counter;
+  return fmt::format(L"\\\\.\\pipe\\foo_uie_console-tests-{}-{}",
+                     GetCurrentProcessId(), ++counter);
+}
+
+/** Publishes messages to a loopback client, and returns the latency of each */
+std::vector<int64_t> stream_messages_to_loopback_client(size_t message_count) {
+  MessageStream stream(get_test_pipe_name(), message_count);
+  MessageStreamTestClient client(stream.get_pipe_name());
+
+  REQUIRE(wait_until([&] { return stream.get_client_count() == 1; }));
+
+  std::vector<int64_t> latencies_us;
+  latencies_us.reserve(message_count);
+
+  std::jthread reader([&] {
+    for (size_t index{}; index < message_count; ++index) {
+      const auto record = client.read_record();
+      const auto now_us =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::system_clock::now().time_since_epoch())
+              .count();
+
+      if (!record || record->text != fmt::format("Message {}", index))
+        break;
+
+      latencies_us.emplace_back(now_us - record->timestamp_us);
+    }
+  });
+
+  for (size_t index{}; index < message_count; ++index)
+    stream.publish(std::chrono::system_clock::now(),
+                   fmt::format("Message {}", index));
+
+  reader.join();
+
+  return latencies_us;
+}
+
+TEST_CASE("message stream delivers records to loopback client") {
+  CHECK(stream_messages_to_loopback_client(1'000).size() == 1'000);
+}
+
+TEST_CASE("message stream does not share its pipe name") {
+  MessageStream stream(get_test_pipe_name());
+
+  CHECK_THROWS(MessageStream(stream.get_pipe_name()));
+}
+
+TEST_CASE("benchmark message stream" * doctest::skip()) {
+  constexpr size_t message_count = 100'000;
+
+  const auto start = std::chrono::steady_clock::now();
+  auto latencies_us = stream_messages_to_loopback_client(message_count);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  REQUIRE(latencies_us.size() == message_count);
+
+  std::ranges::sort(latencies_us);
+  const auto elapsed_s = std::chrono::duration<double>(elapsed).count();
+
+  MESSAGE(fmt::format("{} records in {:.3f} s ({:.0f} records/s), latency "
+                      "p50 {} us, p99 {} us, max {} us",
+                      message_count, elapsed_s, message_count / elapsed_s,
+                      latencies_us[message_count / 2],
+                      latencies_us[message_count * 99 / 100],
+                      latencies_us.back()));
+}
+
+TEST_CASE("message stream drops clients that do not keep up") {
+  MessageStream stream(get_test_pipe_name(), 4);
+  MessageStreamTestClient client(stream.get_pipe_name());
+
+  REQUIRE(wait_until([&] { return stream.get_client_count() == 1; }));
+
+  const std::string text(16 * 1024, 'x');
+
+  /** The client never reads, so its pipe buffer and then its queue fill up */
+  for (size_t index{}; index < 64 && stream.get_client_count() > 0; ++index)
+    stream.publish(std::chrono::system_clock::now(), text);
+
+  CHECK(wait_until([&] { return stream.get_client_count() == 0; }));
+}